@@ -0,0 +1,179 @@
+#ifndef UUID_6E2B8C14_D93A_4F57_8B0E_3A71C5F9D208
+#define UUID_6E2B8C14_D93A_4F57_8B0E_3A71C5F9D208
+
+#include <random_quad.hpp>
+
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace thrasher {
+  class TextureHandle final {
+  public:
+    TextureHandle() : handle{0} { glGenTextures(1, &handle); }
+    TextureHandle(TextureHandle const&) = delete;
+    TextureHandle(TextureHandle && other) noexcept : handle{other.handle} {
+      other.handle = 0;
+    }
+    TextureHandle &operator=(TextureHandle const&) = delete;
+    TextureHandle &operator=(TextureHandle && other) noexcept {
+      if (this == &other) return *this;
+      if (0 != handle) glDeleteTextures(1, &handle);
+      handle = other.handle;
+      other.handle = 0;
+      return *this;
+    }
+    ~TextureHandle() {
+      if (0 != handle) glDeleteTextures(1, &handle);
+    }
+
+    explicit operator bool() const {
+      return handle != 0;
+    }
+
+    GLuint get() const {
+      return handle;
+    }
+  private:
+    GLuint handle;
+  };
+
+  class FakeTexture final {
+    static constexpr std::size_t bytes_per_texel = 4;
+  public:
+    template <typename Faker, typename OnSuccess, typename OnFailure>
+    static auto create(
+      GLsizei width, GLsizei height, Faker &faker,
+      OnSuccess on_success, OnFailure on_failure
+    ) {
+      GLsizei texture_size = 0;
+      GLsizei const base_width = width;
+      GLsizei const base_height = height;
+      TextureHandle handle{};
+      if (!handle) return on_failure();
+
+      GLsizei num_mips = std::log2(std::min(width, height));
+      glEnable(GL_TEXTURE_2D);
+      glBindTexture(GL_TEXTURE_2D, handle.get());
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_mips);
+
+      for (GLsizei level = 0; level <= num_mips; ++level) {
+        auto size = width * height * bytes_per_texel;
+        texture_size += size;
+        faker.recolor(size, [=](auto data) {
+          glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        });
+        width /= 2;
+        height /= 2;
+      }
+
+      bool error = false;
+      while (glGetError() != GL_NO_ERROR) { error = true; }
+      if (error) return on_failure();
+
+      return on_success(FakeTexture{texture_size, base_width, base_height, std::move(handle)});
+    }
+
+    GLuint handle() const { return raii_handle.get(); }
+
+    explicit operator bool() const {
+      return static_cast<bool>(raii_handle);
+    }
+
+    GLsizei size_bytes() const {
+      if (!raii_handle) return 0;
+      return texture_size;
+    }
+
+    GLsizei width() const { return base_width; }
+    GLsizei height() const { return base_height; }
+
+  private:
+    FakeTexture(
+      GLsizei texture_size_, GLsizei base_width_, GLsizei base_height_,
+      TextureHandle raii_handle_
+    ) : texture_size{texture_size_}
+      , base_width{base_width_}
+      , base_height{base_height_}
+      , raii_handle{std::move(raii_handle_)} {}
+
+    GLsizei texture_size;
+    GLsizei base_width;
+    GLsizei base_height;
+    TextureHandle raii_handle;
+  };
+
+  // Draws with legacy immediate mode OpenGL into the current context
+  template <typename BufferSwapper>
+  class GLBackend final {
+  public:
+    using Texture = FakeTexture;
+
+    GLBackend(BufferSwapper swap_buffers_, bool double_buffer_)
+      : swap_buffers{std::move(swap_buffers_)}
+      , double_buffer{double_buffer_}
+    {
+      glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    std::size_t max_texture_dimension() const {
+      GLint driver_max_texture_dimension;
+      glGetIntegerv(GL_MAX_TEXTURE_SIZE, &driver_max_texture_dimension);
+      return driver_max_texture_dimension;
+    }
+
+    template <typename Faker, typename OnSuccess, typename OnFailure>
+    auto create_texture(
+      std::size_t width, std::size_t height, Faker &faker,
+      OnSuccess on_success, OnFailure on_failure
+    ) {
+      return FakeTexture::create(width, height, faker, on_success, on_failure);
+    }
+
+    // Gives the driver a chance to reclaim memory after a failed allocation
+    void recover() { glFlush(); }
+
+    void begin_frame() { glClear(GL_COLOR_BUFFER_BIT); }
+
+    void draw(FakeTexture const &texture, QuadPlacement const &placement) {
+      glEnable(GL_TEXTURE_2D);
+      glBindTexture(GL_TEXTURE_2D, texture.handle());
+
+      glBegin(GL_QUADS);
+
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex2f(placement.left, placement.bottom);
+
+      glTexCoord2f(1.0f, 0.0f);
+      glVertex2f(placement.right, placement.bottom);
+
+      glTexCoord2f(1.0f, 1.0f);
+      glVertex2f(placement.right, placement.top);
+
+      glTexCoord2f(0.0f, 1.0f);
+      glVertex2f(placement.left, placement.top);
+
+      glEnd();
+    }
+
+    void end_frame() {
+      if (double_buffer)
+        swap_buffers();
+      else
+        glFlush();
+    }
+
+  private:
+    BufferSwapper swap_buffers;
+    bool double_buffer;
+  };
+}
+
+#endif
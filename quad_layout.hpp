@@ -0,0 +1,239 @@
+#ifndef UUID_3B0E5D2C_8F41_4E7A_9C6D_52A1F0B7E914
+#define UUID_3B0E5D2C_8F41_4E7A_9C6D_52A1F0B7E914
+
+#include <random_helper.hpp>
+#include <random_quad.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace thrasher {
+  enum class LayoutMode {
+    // Every quad lands at fresh random coordinates each frame
+    random,
+    // Every quad gets one random placement when it is created
+    fixed,
+    // Quads tile the viewport, one per cell
+    grid,
+    // Quads tile the viewport, stacked overdraw_factor deep
+    overdraw
+  };
+
+  inline bool parse_layout_mode(std::string const &name, LayoutMode &mode) {
+    if (name == "random") {
+      mode = LayoutMode::random;
+    } else if (name == "fixed") {
+      mode = LayoutMode::fixed;
+    } else if (name == "grid") {
+      mode = LayoutMode::grid;
+    } else if (name == "overdraw") {
+      mode = LayoutMode::overdraw;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  inline char const *layout_mode_name(LayoutMode mode) {
+    switch (mode) {
+      case LayoutMode::random: return "random";
+      case LayoutMode::fixed: return "fixed";
+      case LayoutMode::grid: return "grid";
+      case LayoutMode::overdraw: return "overdraw";
+    }
+    return "unknown";
+  }
+
+  struct LayoutStats {
+    std::size_t quads;
+    // Fraction of the viewport covered by at least one quad, sampled on a
+    // 256x256 grid
+    double coverage;
+    // Total quad area drawn, in viewports
+    double overdraw;
+  };
+
+  class QuadLayout final {
+    static constexpr std::size_t coverage_resolution = 256;
+  public:
+    // A minification ratio of 0 sizes quads to their layout cell instead of
+    // to their texture.
+    QuadLayout(
+      LayoutMode mode_,
+      std::size_t viewport_width_,
+      std::size_t viewport_height_,
+      double overdraw_factor_,
+      double minification_
+    ) : mode{mode_}
+      , viewport_width{viewport_width_}
+      , viewport_height{viewport_height_}
+      , overdraw_factor{overdraw_factor_}
+      , minification{minification_}
+    {}
+
+    LayoutMode get_mode() const { return mode; }
+
+    // Places quads once per thrash so that draws do no layout work. Fixed
+    // quads keep their first placement; grid and overdraw quads are retiled
+    // because the quad count changes.
+    template <typename Quads>
+    void arrange(RandomHelper &generator, Quads &quads) const {
+      switch (mode) {
+        case LayoutMode::random:
+          return;
+        case LayoutMode::fixed:
+          for (auto &quad : quads) {
+            if (!quad.has_placement()) {
+              quad.set_placement(random_placement(generator, quad));
+            }
+          }
+          return;
+        case LayoutMode::grid:
+          tile(quads, quads.size());
+          return;
+        case LayoutMode::overdraw:
+          tile(quads, std::ceil(quads.size() / overdraw_factor));
+          return;
+      }
+    }
+
+    template <typename Quads>
+    LayoutStats measure(Quads const &quads) const {
+      std::vector<QuadPlacement> visible{};
+      double drawn_area = 0.;
+      for (auto const &quad : quads) {
+        if (!quad.has_placement()) continue;
+        auto clipped = clip(quad.placement());
+        if (clipped.right <= clipped.left || clipped.top <= clipped.bottom) {
+          continue;
+        }
+        drawn_area += area(clipped);
+        visible.push_back(clipped);
+      }
+
+      constexpr double viewport_area = 4.;
+      return {
+        quads.size(),
+        covered_fraction(visible),
+        drawn_area / viewport_area
+      };
+    }
+
+  private:
+    // Splits the viewport into exactly cells cells, stretching the last row's
+    // cells across the full width, and deals quads out to them in turn
+    template <typename Quads>
+    void tile(Quads &quads, std::size_t cells) const {
+      cells = std::max<std::size_t>(cells, 1);
+      std::size_t columns = std::ceil(std::sqrt(cells));
+      std::size_t rows = (cells + columns - 1) / columns;
+      std::size_t last_row_columns = cells - (rows - 1) * columns;
+      float cell_height = 2.0f / rows;
+
+      std::size_t index = 0;
+      for (auto &quad : quads) {
+        std::size_t cell = index++ % cells;
+        std::size_t row = cell / columns;
+        std::size_t row_columns = row + 1 == rows ? last_row_columns : columns;
+        float cell_width = 2.0f / row_columns;
+        float left = -1.0f + (cell % columns) * cell_width;
+        float bottom = -1.0f + row * cell_height;
+        if (minification > 0.) {
+          quad.set_placement(centered(
+            quad, left + cell_width / 2, bottom + cell_height / 2
+          ));
+        } else {
+          quad.set_placement({
+            left, left + cell_width, bottom, bottom + cell_height
+          });
+        }
+      }
+    }
+
+    template <typename Quad>
+    QuadPlacement random_placement(RandomHelper &generator, Quad const &quad) const {
+      if (minification > 0.) {
+        float x = generator.random_float(-1.0f, 1.0f);
+        float y = generator.random_float(-1.0f, 1.0f);
+        return centered(quad, x, y);
+      }
+      float x0 = generator.random_float(-1.0f, 1.0f);
+      float x1 = generator.random_float(-1.0f, 1.0f);
+      float y0 = generator.random_float(-1.0f, 1.0f);
+      float y1 = generator.random_float(-1.0f, 1.0f);
+      return {
+        std::min(x0, x1), std::max(x0, x1), std::min(y0, y1), std::max(y0, y1)
+      };
+    }
+
+    // Sizes the quad so that each screen pixel covers minification texels
+    template <typename Quad>
+    QuadPlacement centered(Quad const &quad, float x, float y) const {
+      float half_width = quad.width_texels() / minification / viewport_width;
+      float half_height = quad.height_texels() / minification / viewport_height;
+      return {x - half_width, x + half_width, y - half_height, y + half_height};
+    }
+
+    static QuadPlacement clip(QuadPlacement placement) {
+      return {
+        std::max(placement.left, -1.0f),
+        std::min(placement.right, 1.0f),
+        std::max(placement.bottom, -1.0f),
+        std::min(placement.top, 1.0f)
+      };
+    }
+
+    static double area(QuadPlacement const &placement) {
+      return double(placement.right - placement.left) *
+        (placement.top - placement.bottom);
+    }
+
+    // Counts the cells of a coverage_resolution square grid whose centres
+    // fall inside at least one quad. Each quad marks the corners of its cell
+    // range in a difference table, so the cost is linear in the quad count
+    // and the grid size.
+    static double covered_fraction(std::vector<QuadPlacement> const &placements) {
+      constexpr std::size_t cells = coverage_resolution;
+      std::vector<int> counts((cells + 1) * (cells + 1), 0);
+      auto at = [&](std::size_t x, std::size_t y) -> int & {
+        return counts[y * (cells + 1) + x];
+      };
+      // The first cell whose centre is at or past coordinate
+      auto first_cell = [](float coordinate) {
+        auto cell = std::ceil((coordinate + 1.0f) / 2.0f * cells - 0.5f);
+        return static_cast<std::size_t>(std::min<float>(std::max(cell, 0.0f), cells));
+      };
+
+      for (auto const &placement : placements) {
+        auto x0 = first_cell(placement.left), x1 = first_cell(placement.right);
+        auto y0 = first_cell(placement.bottom), y1 = first_cell(placement.top);
+        if (x1 <= x0 || y1 <= y0) continue;
+        ++at(x0, y0);
+        --at(x1, y0);
+        --at(x0, y1);
+        ++at(x1, y1);
+      }
+
+      std::size_t covered = 0;
+      for (std::size_t y = 0; y < cells; ++y) {
+        for (std::size_t x = 0; x < cells; ++x) {
+          if (x > 0) at(x, y) += at(x - 1, y);
+          if (y > 0) at(x, y) += at(x, y - 1);
+          if (x > 0 && y > 0) at(x, y) -= at(x - 1, y - 1);
+          if (at(x, y) > 0) ++covered;
+        }
+      }
+      return double(covered) / (cells * cells);
+    }
+
+    LayoutMode mode;
+    std::size_t viewport_width;
+    std::size_t viewport_height;
+    double overdraw_factor;
+    double minification;
+  };
+}
+
+#endif
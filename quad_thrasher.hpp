@@ -1,48 +1,99 @@
 #ifndef UUID_A7972692_0ADA_41D3_B90D_F31B297F28CB
 #define UUID_A7972692_0ADA_41D3_B90D_F31B297F28CB
 
+#include <quad_layout.hpp>
 #include <random_quad.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
 #include <random>
 
 namespace thrasher {
-  template <typename Faker>
+  struct ThrashSettings {
+    std::size_t average_memory_usage_bytes;
+    std::size_t delta_bytes;
+    std::size_t min_texture_dimension_texels;
+    std::size_t max_texture_dimension_texels;
+    // Probability that each quad is deleted on a thrash
+    double eviction_probability;
+  };
+
+  // Running totals since the thrasher was created
+  struct ThrashCounters {
+    std::size_t quads_created;
+    std::size_t quads_deleted;
+    std::size_t creation_failures;
+  };
+
+  // Keeps Backend's texture memory usage within the configured band
+  template <typename Backend, typename Faker>
   class QuadThrasher final {
     static constexpr std::size_t bytes_per_texel = 4;
+    using Quad = RandomQuad<Backend>;
   public:
     QuadThrasher(
+      Backend &backend_,
       RandomHelper &generator,
-      std::size_t average_memory_usage_bytes_,
-      std::size_t delta_bytes_,
-      std::size_t max_texture_dimension_texels_
-    ) : average_memory_usage_bytes{average_memory_usage_bytes_}
-      , delta_bytes{delta_bytes_}
+      ThrashSettings settings_,
+      std::size_t max_texture_dimension_texels_,
+      QuadLayout layout_
+    ) : backend{backend_}
+      , settings{settings_}
       , max_texture_dimension_texels{max_texture_dimension_texels_}
       , faker{
           generator,
           max_texture_dimension_texels * max_texture_dimension_texels * bytes_per_texel
         }
+      , layout{layout_}
+      , counters{}
       , quads{}
-    {}
+    {
+      set_settings(settings_);
+    }
+
+    // Takes effect on the next thrash. Texture dimensions are clamped to the
+    // maximum the thrasher was constructed with.
+    void set_settings(ThrashSettings settings_) {
+      settings = settings_;
+      settings.max_texture_dimension_texels = std::min(
+        settings.max_texture_dimension_texels, max_texture_dimension_texels
+      );
+      settings.min_texture_dimension_texels = std::max<std::size_t>(
+        std::min(settings.min_texture_dimension_texels, settings.max_texture_dimension_texels), 1
+      );
+    }
 
     void thrash(RandomHelper &generator) {
       randomly_delete_quads(generator);
 
       fill_headroom(generator, get_headroom_bytes(generator, get_bytes_used()));
+
+      layout.arrange(generator, quads);
     }
 
+    QuadLayout const &get_layout() const { return layout; }
+
+    LayoutStats layout_stats() const { return layout.measure(quads); }
+
+    ThrashCounters const &get_counters() const { return counters; }
+
+    std::size_t bytes_used() const { return get_bytes_used(); }
+
     void draw(RandomHelper &generator) const {
       for (auto const &quad : quads) {
-        quad.draw(generator);
+        quad.draw(backend, generator);
       }
     }
 
   private:
     void randomly_delete_quads(RandomHelper &generator) {
       auto new_end = std::remove_if(
-        begin(quads), end(quads), [&](auto&) { return generator.random_bool(); }
+        begin(quads), end(quads), [&](auto&) {
+          return generator.random_chance(settings.eviction_probability);
+        }
       );
+      counters.quads_deleted += std::distance(new_end, end(quads));
       quads.erase(new_end, end(quads));
     }
 
@@ -57,8 +108,8 @@ namespace thrasher {
       std::size_t bytes_used
     ) const {
       std::size_t max_bytes_this_thrash = generator.random_size(
-        average_memory_usage_bytes - delta_bytes,
-        average_memory_usage_bytes + delta_bytes
+        settings.average_memory_usage_bytes - settings.delta_bytes,
+        settings.average_memory_usage_bytes + settings.delta_bytes
       );
       max_bytes_this_thrash = std::max(max_bytes_this_thrash, bytes_used);
 
@@ -67,34 +118,42 @@ namespace thrasher {
 
     void fill_headroom(RandomHelper &generator, std::size_t headroom_bytes) {
       while (true) {
-        std::size_t width = generator.random_size(1, max_texture_dimension_texels);
-        std::size_t height = generator.random_size(1, max_texture_dimension_texels);
+        std::size_t width = generator.random_size(
+          settings.min_texture_dimension_texels, settings.max_texture_dimension_texels
+        );
+        std::size_t height = generator.random_size(
+          settings.min_texture_dimension_texels, settings.max_texture_dimension_texels
+        );
         // 4/3 for size with mips, add 0.5 to round up
         std::size_t pending_texture_size_bound =
           (width * height * bytes_per_texel * 4. / 3.) + 0.5;
         if (pending_texture_size_bound > headroom_bytes) break;
-        RandomQuad::create(
-          width, height, faker,
-          [&](RandomQuad quad) {
+        Quad::create(
+          backend, width, height, faker,
+          [&](Quad quad) {
             quads.emplace_back(std::move(quad));
+            ++counters.quads_created;
             headroom_bytes -= quads.back().size_bytes();
           },
           [&]() {
             fprintf(stderr, "Error creating quad!\n");
+            ++counters.creation_failures;
             // Ensure that the loop will terminate
             headroom_bytes -= pending_texture_size_bound;
-            glFlush();
+            backend.recover();
           }
         );
       }
     }
 
     std::size_t frame_count;
-    std::size_t average_memory_usage_bytes;
-    std::size_t delta_bytes;
+    Backend &backend;
+    ThrashSettings settings;
     std::size_t max_texture_dimension_texels;
     Faker faker;
-    std::vector<RandomQuad> quads;
+    QuadLayout layout;
+    ThrashCounters counters;
+    std::vector<Quad> quads;
   };
 }
 
@@ -23,8 +23,8 @@ namespace thrasher {
       return dist(mt);
     }
 
-    bool random_bool() {
-      std::bernoulli_distribution dist{0.5};
+    bool random_chance(double probability) {
+      std::bernoulli_distribution dist{probability};
       return dist(mt);
     }
 
@@ -0,0 +1,267 @@
+#ifndef UUID_9D2F6A41_7C3B_4E0F_A5B8_1E64C7D0F352
+#define UUID_9D2F6A41_7C3B_4E0F_A5B8_1E64C7D0F352
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace thrasher {
+  struct PhaseParameters {
+    std::size_t memory_cap;
+    // Fraction of memory_cap that usage oscillates by
+    double delta;
+    std::size_t interval;
+    std::size_t min_texture_dimension;
+    std::size_t max_texture_dimension;
+    // Probability that a quad is deleted on each thrash
+    double eviction;
+  };
+
+  struct Phase {
+    std::string name;
+    // In frames. 0 runs forever, and is only allowed for the last phase.
+    std::size_t duration;
+    // Frames over which parameters move linearly from the previous phase's
+    std::size_t ramp;
+    PhaseParameters parameters;
+  };
+
+  namespace detail {
+    inline std::size_t lerp_size(std::size_t from, std::size_t to, double t) {
+      return std::llround(from + (double(to) - double(from)) * t);
+    }
+
+    inline double lerp_double(double from, double to, double t) {
+      return from + (to - from) * t;
+    }
+
+    inline std::string trim(std::string const &text) {
+      auto first = text.find_first_not_of(" \t\r");
+      if (first == std::string::npos) return "";
+      auto last = text.find_last_not_of(" \t\r");
+      return text.substr(first, last - first + 1);
+    }
+
+    inline bool parse_size(std::string const &text, std::size_t &value) {
+      if (text.empty() || text[0] == '-') return false;
+      char *end = nullptr;
+      errno = 0;
+      auto parsed = std::strtoull(text.c_str(), &end, 10);
+      if (errno != 0 || *end != '\0') return false;
+      value = parsed;
+      return true;
+    }
+
+    inline bool parse_fraction(std::string const &text, double &value) {
+      if (text.empty()) return false;
+      char *end = nullptr;
+      errno = 0;
+      auto parsed = std::strtod(text.c_str(), &end);
+      // Written so that NaN fails the range check
+      if (errno != 0 || *end != '\0' || !(parsed >= 0. && parsed <= 1.)) return false;
+      value = parsed;
+      return true;
+    }
+
+    inline bool set_phase_value(
+      Phase &phase, std::string const &key, std::string const &value
+    ) {
+      auto &parameters = phase.parameters;
+      if (key == "duration") return parse_size(value, phase.duration);
+      if (key == "ramp") return parse_size(value, phase.ramp);
+      if (key == "memory-cap") return parse_size(value, parameters.memory_cap);
+      if (key == "delta") return parse_fraction(value, parameters.delta);
+      if (key == "interval") {
+        return parse_size(value, parameters.interval) && parameters.interval > 0;
+      }
+      if (key == "min-texture-size") {
+        return parse_size(value, parameters.min_texture_dimension) &&
+          parameters.min_texture_dimension > 0;
+      }
+      if (key == "max-texture-size") {
+        return parse_size(value, parameters.max_texture_dimension) &&
+          parameters.max_texture_dimension > 0;
+      }
+      if (key == "eviction") return parse_fraction(value, parameters.eviction);
+      return false;
+    }
+
+    inline bool validate_phases(char const *path, std::vector<Phase> const &phases) {
+      if (phases.empty()) {
+        fprintf(stderr, "%s: scenario has no phases\n", path);
+        return false;
+      }
+      for (std::size_t i = 0; i < phases.size(); ++i) {
+        auto const &phase = phases[i];
+        auto const &parameters = phase.parameters;
+        if (phase.duration == 0 && i + 1 != phases.size()) {
+          fprintf(stderr, "%s: only the last phase may run forever (phase %s)\n", path, phase.name.c_str());
+          return false;
+        }
+        if (i == 0 && phase.ramp != 0) {
+          fprintf(stderr, "%s: the first phase has nothing to ramp from (phase %s)\n", path, phase.name.c_str());
+          return false;
+        }
+        if (phase.duration != 0 && phase.ramp > phase.duration) {
+          fprintf(stderr, "%s: ramp is longer than phase %s\n", path, phase.name.c_str());
+          return false;
+        }
+        if (parameters.min_texture_dimension > parameters.max_texture_dimension) {
+          fprintf(stderr, "%s: min-texture-size exceeds max-texture-size in phase %s\n", path, phase.name.c_str());
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  class Scenario final {
+  public:
+    explicit Scenario(std::vector<Phase> phases_) : phases{std::move(phases_)} {}
+
+    std::size_t size() const { return phases.size(); }
+
+    Phase const &phase(std::size_t index) const { return phases[index]; }
+
+    // The parameters in effect on the given frame of a phase, ramping from the
+    // previous phase's parameters over the phase's first ramp frames
+    PhaseParameters parameters(std::size_t index, std::size_t frame) const {
+      auto const &to = phases[index];
+      if (index == 0 || frame >= to.ramp) return to.parameters;
+
+      auto const &from = phases[index - 1].parameters;
+      double t = double(frame) / to.ramp;
+      PhaseParameters result;
+      result.memory_cap = detail::lerp_size(from.memory_cap, to.parameters.memory_cap, t);
+      result.delta = detail::lerp_double(from.delta, to.parameters.delta, t);
+      result.interval = std::max<std::size_t>(
+        detail::lerp_size(from.interval, to.parameters.interval, t), 1
+      );
+      result.min_texture_dimension = detail::lerp_size(
+        from.min_texture_dimension, to.parameters.min_texture_dimension, t
+      );
+      result.max_texture_dimension = detail::lerp_size(
+        from.max_texture_dimension, to.parameters.max_texture_dimension, t
+      );
+      result.eviction = detail::lerp_double(from.eviction, to.parameters.eviction, t);
+      return result;
+    }
+
+    std::size_t max_texture_dimension() const {
+      std::size_t result = 0;
+      for (auto const &phase : phases) {
+        result = std::max(result, phase.parameters.max_texture_dimension);
+      }
+      return result;
+    }
+
+    void clamp_texture_dimension(std::size_t max_texture_dimension) {
+      for (auto &phase : phases) {
+        auto &parameters = phase.parameters;
+        parameters.max_texture_dimension = std::min(
+          parameters.max_texture_dimension, max_texture_dimension
+        );
+        parameters.min_texture_dimension = std::min(
+          parameters.min_texture_dimension, max_texture_dimension
+        );
+      }
+    }
+
+    void print() const {
+      for (auto const &phase : phases) {
+        auto const &parameters = phase.parameters;
+        printf(
+          "phase %s: %lu frames (ramp %lu), cap %lu bytes, delta %g, "
+          "interval %lu, textures %lu-%lu texels, eviction %g\n",
+          phase.name.c_str(), phase.duration, phase.ramp, parameters.memory_cap,
+          parameters.delta, parameters.interval, parameters.min_texture_dimension,
+          parameters.max_texture_dimension, parameters.eviction
+        );
+      }
+    }
+
+  private:
+    std::vector<Phase> phases;
+  };
+
+  // Reads an INI-style scenario. Each [section] starts a phase, and any key a
+  // phase leaves out carries over from the phase before it (or from defaults
+  // for the first phase):
+  //
+  //   [startup]
+  //   duration = 600
+  //   memory-cap = 800000000
+  //   delta = 0.1
+  //   interval = 5
+  //   min-texture-size = 256
+  //   max-texture-size = 2048
+  //   eviction = 0.9
+  //
+  //   [steady]
+  //   duration = 3600
+  //   ramp = 300
+  //   memory-cap = 400000000
+  //   eviction = 0.25
+  //
+  // Everything after a '#', and lines starting with ';', are comments.
+  template <typename Callback>
+  bool load_scenario(
+    char const *path,
+    PhaseParameters const &defaults,
+    Callback callback
+  ) {
+    std::ifstream file{path};
+    if (!file) {
+      fprintf(stderr, "Could not open scenario %s\n", path);
+      return false;
+    }
+
+    std::vector<Phase> phases{};
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(file, line)) {
+      ++line_number;
+      line = detail::trim(line.substr(0, line.find('#')));
+      if (line.empty() || line[0] == '#' || line[0] == ';') continue;
+
+      if (line.front() == '[') {
+        if (line.back() != ']') {
+          fprintf(stderr, "%s:%lu: unterminated section\n", path, line_number);
+          return false;
+        }
+        Phase phase{};
+        phase.name = detail::trim(line.substr(1, line.size() - 2));
+        phase.parameters = phases.empty() ? defaults : phases.back().parameters;
+        phases.push_back(std::move(phase));
+        continue;
+      }
+
+      auto equals = line.find('=');
+      if (equals == std::string::npos) {
+        fprintf(stderr, "%s:%lu: expected key = value\n", path, line_number);
+        return false;
+      }
+      if (phases.empty()) {
+        fprintf(stderr, "%s:%lu: value outside of a [phase]\n", path, line_number);
+        return false;
+      }
+      auto key = detail::trim(line.substr(0, equals));
+      auto value = detail::trim(line.substr(equals + 1));
+      if (!detail::set_phase_value(phases.back(), key, value)) {
+        fprintf(stderr, "%s:%lu: invalid %s: %s\n", path, line_number, key.c_str(), value.c_str());
+        return false;
+      }
+    }
+
+    if (!detail::validate_phases(path, phases)) return false;
+
+    return callback(Scenario{std::move(phases)});
+  }
+}
+
+#endif
@@ -1,6 +1,11 @@
+#include <gl_backend.hpp>
 #include <quad_thrasher.hpp>
 #include <random_helper.hpp>
+#include <scenario.hpp>
 #include <window.hpp>
+#ifdef THRASHER_HAVE_VULKAN
+#include <vulkan_backend.hpp>
+#endif
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -8,108 +13,267 @@
 #pragma GCC diagnostic pop
 
 #include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <limits>
+#include <string>
 #include <thread>
-
-#include <GL/gl.h>
+#include <vector>
 
 namespace {
-  template <typename Faker, typename BufferSwapper>
+  class PhaseStats final {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+  public:
+    explicit PhaseStats(thrasher::ThrashCounters const &start_)
+      : start{start_}
+      , frames{0}
+      , thrashes{0}
+      , total_frame_time{0}
+      , max_frame_time{0}
+      , min_bytes{std::numeric_limits<std::size_t>::max()}
+      , max_bytes{0}
+      , total_bytes{0}
+    {}
+
+    void record_frame(milliseconds frame_time) {
+      ++frames;
+      total_frame_time += frame_time;
+      max_frame_time = std::max(max_frame_time, frame_time);
+    }
+
+    void record_thrash(std::size_t bytes_used) {
+      ++thrashes;
+      min_bytes = std::min(min_bytes, bytes_used);
+      max_bytes = std::max(max_bytes, bytes_used);
+      total_bytes += bytes_used;
+    }
+
+    std::size_t thrash_count() const { return thrashes; }
+
+    void print(char const *name, thrasher::ThrashCounters const &end) const {
+      if (frames == 0) return;
+      printf("phase %s summary:\n", name);
+      printf("  frames: %lu, thrashes: %lu\n", frames, thrashes);
+      printf(
+        "  frame time: mean %.3f ms, max %.3f ms\n",
+        total_frame_time.count() / frames, max_frame_time.count()
+      );
+      if (thrashes != 0) {
+        printf(
+          "  memory used: min %lu, mean %lu, max %lu bytes\n",
+          min_bytes, total_bytes / thrashes, max_bytes
+        );
+      }
+      printf(
+        "  quads: %lu created, %lu deleted, %lu failed\n",
+        end.quads_created - start.quads_created,
+        end.quads_deleted - start.quads_deleted,
+        end.creation_failures - start.creation_failures
+      );
+    }
+
+  private:
+    thrasher::ThrashCounters start;
+    std::size_t frames;
+    std::size_t thrashes;
+    milliseconds total_frame_time;
+    milliseconds max_frame_time;
+    std::size_t min_bytes;
+    std::size_t max_bytes;
+    std::size_t total_bytes;
+  };
+
+  template <typename Backend, typename Faker>
   class DrawLoop {
+    static constexpr std::size_t running_summary_thrashes = 100;
   public:
     DrawLoop(
-      BufferSwapper swap_buffers,
+      Backend &backend_,
       std::size_t max_texture_dimension_texels,
-      std::size_t average_memory_usage_bytes,
-      std::size_t delta_bytes,
-      std::size_t thrash_interval_,
-      bool draw_,
-      bool double_buffer_
+      thrasher::Scenario scenario_,
+      thrasher::QuadLayout layout,
+      bool draw_
     ) : frame_count{0}
-      , thrash_interval{thrash_interval_}
-      , swap_buffers{std::move(swap_buffers)}
+      , scenario{std::move(scenario_)}
+      , backend{backend_}
       , generator{}
       , thrasher{
+          backend,
           generator,
-          average_memory_usage_bytes,
-          delta_bytes,
-          max_texture_dimension_texels
+          settings_for(scenario.parameters(0, 0)),
+          max_texture_dimension_texels,
+          layout
         }
       , draw{draw_}
-      , double_buffer{double_buffer_}
     {}
 
     bool operator()() {
-      glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+      for (std::size_t phase = 0; phase < scenario.size(); ++phase) {
+        run_phase(phase);
+      }
 
-      while (true) {
-        glClear(GL_COLOR_BUFFER_BIT);
-        if (frame_count % thrash_interval == 0) {
+      return true;
+    }
+  private:
+    static thrasher::ThrashSettings settings_for(
+      thrasher::PhaseParameters const &parameters
+    ) {
+      return {
+        parameters.memory_cap,
+        static_cast<std::size_t>(parameters.memory_cap * parameters.delta),
+        parameters.min_texture_dimension,
+        parameters.max_texture_dimension,
+        parameters.eviction
+      };
+    }
+
+    void run_phase(std::size_t index) {
+      auto const &phase = scenario.phase(index);
+      if (scenario.size() > 1) printf("phase %s\n", phase.name.c_str());
+
+      // Thrash on the phase's first frame, so that even a phase shorter than
+      // the interval runs with its own parameters
+      frame_count = std::numeric_limits<std::size_t>::max();
+      PhaseStats stats{thrasher.get_counters()};
+      for (std::size_t frame = 0; phase.duration == 0 || frame < phase.duration; ++frame) {
+        auto frame_start = std::chrono::steady_clock::now();
+        auto parameters = scenario.parameters(index, frame);
+
+        backend.begin_frame();
+        // The interval is an upper bound, so a ramp that shortens it takes
+        // effect immediately
+        bool thrashed = frame_count >= parameters.interval;
+        if (thrashed) {
+          thrasher.set_settings(settings_for(parameters));
           thrasher.thrash(generator);
           frame_count = 0;
+          stats.record_thrash(thrasher.bytes_used());
+          // Phases that run forever never end, so report on them as they go
+          if (phase.duration == 0 && stats.thrash_count() % running_summary_thrashes == 0) {
+            stats.print(phase.name.c_str(), thrasher.get_counters());
+          }
         }
         if (draw) {
           thrasher.draw(generator);
         }
-        if (double_buffer)
-          swap_buffers();
-        else
-          glFlush();
+        backend.end_frame();
         ++frame_count;
+
+        stats.record_frame(std::chrono::steady_clock::now() - frame_start);
+        // Kept out of the frame time, since it is not part of the workload
+        if (thrashed) print_layout_stats();
       }
 
-      return true;
+      stats.print(phase.name.c_str(), thrasher.get_counters());
     }
-  private:
+
+    void print_layout_stats() const {
+      // Random layouts move every frame, so there is nothing stable to report
+      if (thrasher.get_layout().get_mode() == thrasher::LayoutMode::random) return;
+      auto stats = thrasher.layout_stats();
+      printf(
+        "layout: %lu quads, coverage: %.3f, overdraw: %.3f\n",
+        stats.quads, stats.coverage, stats.overdraw
+      );
+    }
+
+    // Frames since the last thrash. Saturated at the start of each phase so
+    // that its first frame thrashes.
     std::size_t frame_count;
-    std::size_t thrash_interval;
-    BufferSwapper swap_buffers;
+    thrasher::Scenario scenario;
+    Backend &backend;
     thrasher::RandomHelper generator;
-    thrasher::QuadThrasher<Faker> thrasher;
+    thrasher::QuadThrasher<Backend, Faker> thrasher;
     bool draw;
-    bool double_buffer;
   };
 
+  enum class BackendKind { gl, vulkan };
+
   struct ParsedArgs {
+    BackendKind backend;
     std::size_t width;
     std::size_t height;
     std::size_t max_texture_dimension;
     std::size_t memory_cap;
     std::size_t delta;
     std::size_t interval;
+    thrasher::LayoutMode layout;
+    double overdraw;
+    double minify;
     bool should_alloc_buffers;
     bool should_draw;
     bool double_buffer;
+    std::string scenario_path;
+    thrasher::Scenario scenario{std::vector<thrasher::Phase>{}};
 
     void print() const {
+      printf("backend: %s\n", backend == BackendKind::gl ? "gl" : "vulkan");
       printf("width: %lu\n", width);
       printf("height: %lu\n", height);
       printf("max texture size: %lux%lu\n", max_texture_dimension, max_texture_dimension);
-      printf("memory cap: %lu bytes\n", memory_cap);
-      printf("delta: %lu bytes\n", delta);
-      printf("interval: %lu frames\n", interval);
+      // A scenario's phases print their own
+      if (scenario_path.empty()) {
+        printf("memory cap: %lu bytes\n", memory_cap);
+        printf("delta: %lu bytes\n", delta);
+        printf("interval: %lu frames\n", interval);
+      }
+      printf("layout: %s\n", thrasher::layout_mode_name(layout));
+      if (layout == thrasher::LayoutMode::overdraw) {
+        printf("overdraw: %g\n", overdraw);
+      }
+      if (minify > 0.) {
+        printf("minify: %g (mip level %g)\n", minify, std::log2(minify));
+      }
       printf("should alloc buffers: %s\n", should_alloc_buffers ? "true" : "false");
       printf("should draw: %s\n", should_draw ? "true" : "false");
       printf("double buffer: %s\n", double_buffer ? "true" : "false");
+      if (!scenario_path.empty()) {
+        printf("scenario: %s\n", scenario_path.c_str());
+        scenario.print();
+      }
     }
   };
 
-  template <typename Faker, typename BufferSwapper>
-  DrawLoop<Faker, BufferSwapper> make_draw_loop(
-    BufferSwapper swap_buffers,
+  template <typename Faker, typename Backend>
+  DrawLoop<Backend, Faker> make_draw_loop(
+    Backend &backend,
     ParsedArgs const &parsed
   ) {
     return {
-      std::move(swap_buffers),
+      backend,
       parsed.max_texture_dimension,
-      parsed.memory_cap,
-      parsed.delta,
-      parsed.interval,
-      parsed.should_draw,
-      parsed.double_buffer
+      parsed.scenario,
+      {
+        parsed.layout,
+        parsed.width,
+        parsed.height,
+        parsed.overdraw,
+        parsed.minify
+      },
+      parsed.should_draw
     };
   }
 
+  template <typename Backend>
+  bool run(Backend &backend, ParsedArgs &parsed) {
+    std::size_t driver_max_texture_dimension = backend.max_texture_dimension();
+    if (parsed.max_texture_dimension > driver_max_texture_dimension) {
+      parsed.max_texture_dimension = driver_max_texture_dimension;
+      fprintf(
+        stderr,
+        "Warning: requested texture dimension was too big for driver\n"
+      );
+    }
+    parsed.scenario.clamp_texture_dimension(parsed.max_texture_dimension);
+    parsed.print();
+
+    if (parsed.should_alloc_buffers) {
+      return make_draw_loop<thrasher::UniqueBufferFaker>(backend, parsed)();
+    } else {
+      return make_draw_loop<thrasher::SharedBufferFaker>(backend, parsed)();
+    }
+  }
+
   template <typename Callback>
   bool parse_args(int argc, char **argv, Callback callback) {
     args::ArgumentParser arg_parser{"A texture memory thrasher"};
@@ -148,6 +312,45 @@ namespace {
       {'i', "interval"},
       30
     };
+    args::ValueFlag<std::string> backend_flag{
+      arg_parser,
+      "BACKEND",
+      "The graphics API to thrash: gl (in a window) or vulkan (offscreen)",
+      {'b', "backend"},
+      "gl"
+    };
+    args::ValueFlag<std::string> scenario_flag{
+      arg_parser,
+      "FILE",
+      "Follow the multi-phase load profile in FILE. --memory-cap, --delta, "
+      "--interval and --texture-size become the defaults for its first phase",
+      {'s', "scenario"}
+    };
+    args::ValueFlag<std::string> layout_flag{
+      arg_parser,
+      "MODE",
+      "How quads are placed on screen: random (new coordinates every frame), "
+      "fixed (one random placement per quad), grid (tile the viewport) or "
+      "overdraw (tile the viewport --overdraw layers deep)",
+      {'l', "layout"},
+      "random"
+    };
+    args::ValueFlag<double> overdraw_flag{
+      arg_parser,
+      "FACTOR",
+      "The target number of quads covering each pixel in the overdraw layout",
+      {"overdraw"},
+      2.
+    };
+    args::ValueFlag<double> minify_flag{
+      arg_parser,
+      "RATIO",
+      "Size each quad to its texture divided by RATIO, so that sampling reads "
+      "mip level log2(RATIO). Applies to every layout except random. 0 sizes "
+      "quads to their layout cell instead",
+      {"minify"},
+      0.
+    };
     args::ValueFlag<std::size_t> width_flag{
       arg_parser, "WIDTH", "The width of a screen", {'w', "width"}, 500
     };
@@ -200,17 +403,72 @@ namespace {
       return false;
     }
 
+    thrasher::LayoutMode layout;
+    if (!thrasher::parse_layout_mode(args::get(layout_flag), layout)) {
+      fprintf(stderr, "Unknown layout: %s\n", args::get(layout_flag).c_str());
+      return false;
+    }
+
+    if (!(args::get(overdraw_flag) >= 1.)) {
+      fprintf(stderr, "Overdraw factor must be at least 1\n");
+      return false;
+    }
+
+    auto minify = args::get(minify_flag);
+    if (!(minify == 0. || minify >= 1.)) {
+      fprintf(stderr, "Minification ratio must be 0 or at least 1\n");
+      return false;
+    }
+    if (minify != 0. && layout == thrasher::LayoutMode::random) {
+      fprintf(stderr, "--minify has no effect with the random layout\n");
+      return false;
+    }
+
     ParsedArgs parsed;
+    if (args::get(backend_flag) == "gl") {
+      parsed.backend = BackendKind::gl;
+    } else if (args::get(backend_flag) == "vulkan") {
+      parsed.backend = BackendKind::vulkan;
+    } else {
+      fprintf(stderr, "Unknown backend: %s\n", args::get(backend_flag).c_str());
+      return false;
+    }
     parsed.width = args::get(width_flag) * args::get(screen_columns_flag);
     parsed.height = args::get(height_flag) * args::get(screen_rows_flag);
     parsed.max_texture_dimension = args::get(max_texture_flag);
     parsed.memory_cap = args::get(max_memory_flag);
     parsed.delta = args::get(max_memory_flag) * delta_percent;
     parsed.interval = args::get(interval_flag);
+    parsed.layout = layout;
+    parsed.overdraw = args::get(overdraw_flag);
+    parsed.minify = minify;
     parsed.should_alloc_buffers = alloc_buffers_flag;
     parsed.should_draw = !args::get(no_draw_flag);
     parsed.double_buffer = !args::get(single_buffer_flag);
 
+    thrasher::PhaseParameters defaults{
+      parsed.memory_cap,
+      delta_percent,
+      parsed.interval,
+      1,
+      parsed.max_texture_dimension,
+      0.5
+    };
+    if (scenario_flag) {
+      parsed.scenario_path = args::get(scenario_flag);
+      bool loaded = thrasher::load_scenario(
+        parsed.scenario_path.c_str(), defaults,
+        [&parsed](thrasher::Scenario scenario) {
+          parsed.scenario = std::move(scenario);
+          return true;
+        }
+      );
+      if (!loaded) return false;
+      parsed.max_texture_dimension = parsed.scenario.max_texture_dimension();
+    } else {
+      parsed.scenario = thrasher::Scenario{{thrasher::Phase{"default", 0, 0, defaults}}};
+    }
+
     return callback(parsed);
   }
 }
@@ -218,30 +476,25 @@ namespace {
 int main(int argc, char **argv) {
   bool result = parse_args(argc, argv,
     [](auto &parsed) {
+      if (parsed.backend == BackendKind::vulkan) {
+#ifdef THRASHER_HAVE_VULKAN
+        return thrasher::openVulkan(
+          parsed.width, parsed.height,
+          [&parsed](auto &backend) { return run(backend, parsed); }
+        );
+#else
+        fprintf(stderr, "This thrasher was built without Vulkan support\n");
+        return false;
+#endif
+      }
+
       return thrasher::openWindow(
         parsed.width, parsed.height, parsed.double_buffer, "THEFREEZE",
         [&parsed](auto swap_buffers) {
-          GLint driver_max_texture_dimension_;
-          glGetIntegerv(GL_MAX_TEXTURE_SIZE, &driver_max_texture_dimension_);
-          std::size_t driver_max_texture_dimension = driver_max_texture_dimension_;
-          if (parsed.max_texture_dimension > driver_max_texture_dimension) {
-            parsed.max_texture_dimension = driver_max_texture_dimension;
-            fprintf(
-              stderr,
-              "Warning: requested texture dimension was too big for driver\n"
-            );
-          }
-          parsed.print();
-
-          if (parsed.should_alloc_buffers) {
-            return make_draw_loop<thrasher::UniqueBufferFaker>(
-              std::move(swap_buffers), parsed
-            )();
-          } else {
-            return make_draw_loop<thrasher::SharedBufferFaker>(
-              std::move(swap_buffers), parsed
-            )();
-          }
+          thrasher::GLBackend<decltype(swap_buffers)> backend{
+            std::move(swap_buffers), parsed.double_buffer
+          };
+          return run(backend, parsed);
         }
       );
     }
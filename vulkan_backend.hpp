@@ -0,0 +1,1224 @@
+#ifndef UUID_B41C7E90_25D8_4A6F_9E3B_C08D17F4A6E5
+#define UUID_B41C7E90_25D8_4A6F_9E3B_C08D17F4A6E5
+
+#include <random_quad.hpp>
+#include <vulkan_shaders.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace thrasher {
+  namespace detail {
+    inline bool vk_check(VkResult result, char const *what) {
+      if (result == VK_SUCCESS) return true;
+      fprintf(stderr, "%s failed: %d\n", what, static_cast<int>(result));
+      return false;
+    }
+  }
+
+  // Hands out ranges of large VkDeviceMemory blocks, so that texture churn
+  // exercises the suballocator rather than one driver allocation per texture.
+  // Blocks are returned to the driver as soon as they are empty.
+  class DeviceMemoryArena final {
+    static constexpr VkDeviceSize block_size = 64 * 1024 * 1024;
+
+    struct Block {
+      VkDeviceMemory memory;
+      VkDeviceSize size;
+      std::uint32_t memory_type;
+      // Offset to size, kept coalesced
+      std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+      std::size_t live_allocations;
+    };
+  public:
+    struct Allocation {
+      Block *block;
+      VkDeviceMemory memory;
+      VkDeviceSize offset;
+      VkDeviceSize size;
+    };
+
+    DeviceMemoryArena(VkPhysicalDevice physical_device, VkDevice device_)
+      : device{device_}
+      , memory_properties{}
+      , blocks{}
+    {
+      vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+    }
+    DeviceMemoryArena(DeviceMemoryArena const&) = delete;
+    DeviceMemoryArena &operator=(DeviceMemoryArena const&) = delete;
+    ~DeviceMemoryArena() {
+      for (auto &block : blocks) vkFreeMemory(device, block->memory, nullptr);
+    }
+
+    bool allocate(VkMemoryRequirements const &requirements, Allocation &allocation) {
+      std::uint32_t memory_type = 0;
+      if (!find_memory_type(requirements.memoryTypeBits, memory_type)) {
+        fprintf(stderr, "No memory type for image\n");
+        return false;
+      }
+
+      for (auto &block : blocks) {
+        if (block->memory_type != memory_type) continue;
+        if (suballocate(*block, requirements, allocation)) return true;
+      }
+
+      VkMemoryAllocateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      info.allocationSize = requirements.size > block_size ? requirements.size : block_size;
+      info.memoryTypeIndex = memory_type;
+      VkDeviceMemory memory;
+      if (!detail::vk_check(vkAllocateMemory(device, &info, nullptr, &memory), "vkAllocateMemory")) {
+        return false;
+      }
+
+      std::unique_ptr<Block> block{new Block{memory, info.allocationSize, memory_type, {}, 0}};
+      block->free_ranges[0] = block->size;
+      blocks.push_back(std::move(block));
+      return suballocate(*blocks.back(), requirements, allocation);
+    }
+
+    void release(Allocation const &allocation) {
+      auto &block = *allocation.block;
+      auto &free_ranges = block.free_ranges;
+      VkDeviceSize offset = allocation.offset;
+      VkDeviceSize size = allocation.size;
+
+      auto next = free_ranges.lower_bound(offset);
+      if (next != free_ranges.end() && offset + size == next->first) {
+        size += next->second;
+        next = free_ranges.erase(next);
+      }
+      if (next != free_ranges.begin() && std::prev(next)->first + std::prev(next)->second == offset) {
+        std::prev(next)->second += size;
+      } else {
+        free_ranges[offset] = size;
+      }
+
+      if (--block.live_allocations != 0) return;
+      vkFreeMemory(device, block.memory, nullptr);
+      blocks.erase(std::find_if(
+        begin(blocks), end(blocks), [&](auto &candidate) { return candidate.get() == &block; }
+      ));
+    }
+
+  private:
+    bool find_memory_type(std::uint32_t type_bits, std::uint32_t &memory_type) const {
+      bool found = false;
+      for (std::uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        if (!(type_bits & (1u << i))) continue;
+        auto flags = memory_properties.memoryTypes[i].propertyFlags;
+        if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+          memory_type = i;
+          return true;
+        }
+        if (!found) {
+          memory_type = i;
+          found = true;
+        }
+      }
+      return found;
+    }
+
+    // First fit. Alignment padding stays in the free list.
+    static bool suballocate(
+      Block &block,
+      VkMemoryRequirements const &requirements,
+      Allocation &allocation
+    ) {
+      auto &free_ranges = block.free_ranges;
+      for (auto range = free_ranges.begin(); range != free_ranges.end(); ++range) {
+        VkDeviceSize range_offset = range->first;
+        VkDeviceSize range_end = range->first + range->second;
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        VkDeviceSize start = (range_offset + alignment - 1) / alignment * alignment;
+        if (start + requirements.size > range_end) continue;
+
+        free_ranges.erase(range);
+        if (start > range_offset) free_ranges[range_offset] = start - range_offset;
+        if (start + requirements.size < range_end) {
+          free_ranges[start + requirements.size] = range_end - start - requirements.size;
+        }
+
+        ++block.live_allocations;
+        allocation = {&block, block.memory, start, requirements.size};
+        return true;
+      }
+      return false;
+    }
+
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    std::vector<std::unique_ptr<Block>> blocks;
+  };
+
+  class VulkanBackend;
+
+  class VulkanTexture final {
+    // Everything a texture holds, released together once no frame in flight
+    // can sample it
+    struct Resources {
+      VkImage image;
+      VkImageView view;
+      std::size_t descriptor_pool;
+      VkDescriptorSet descriptor_set;
+      DeviceMemoryArena::Allocation allocation;
+    };
+  public:
+    VulkanTexture(VulkanTexture const&) = delete;
+    VulkanTexture(VulkanTexture && other) noexcept
+      : owner{other.owner}
+      , resources{other.resources}
+      , texture_size{other.texture_size}
+      , base_width{other.base_width}
+      , base_height{other.base_height}
+    {
+      other.resources.image = VK_NULL_HANDLE;
+    }
+    VulkanTexture &operator=(VulkanTexture const&) = delete;
+    VulkanTexture &operator=(VulkanTexture && other) noexcept {
+      if (this == &other) return *this;
+      reset();
+      owner = other.owner;
+      resources = other.resources;
+      texture_size = other.texture_size;
+      base_width = other.base_width;
+      base_height = other.base_height;
+      other.resources.image = VK_NULL_HANDLE;
+      return *this;
+    }
+    ~VulkanTexture() { reset(); }
+
+    explicit operator bool() const {
+      return resources.image != VK_NULL_HANDLE;
+    }
+
+    std::size_t size_bytes() const {
+      if (!resources.image) return 0;
+      return texture_size;
+    }
+
+    std::size_t width() const { return base_width; }
+    std::size_t height() const { return base_height; }
+
+  private:
+    friend class VulkanBackend;
+
+    VulkanTexture(
+      VulkanBackend *owner_,
+      Resources resources_,
+      std::size_t texture_size_,
+      std::size_t base_width_,
+      std::size_t base_height_
+    ) : owner{owner_}
+      , resources{resources_}
+      , texture_size{texture_size_}
+      , base_width{base_width_}
+      , base_height{base_height_}
+    {}
+
+    inline void reset();
+
+    VulkanBackend *owner;
+    Resources resources;
+    std::size_t texture_size;
+    std::size_t base_width;
+    std::size_t base_height;
+  };
+
+  // Renders headlessly into an offscreen image, so it runs on Mesa's lavapipe
+  // without a GPU or a display. Textures are uploaded through a staging
+  // buffer on a transfer queue, and frames are paced with timeline semaphores.
+  //
+  // Each quad is a four vertex triangle strip whose fragment shader samples
+  // the texture through a trilinear sampler, like the GL backend's
+  // GL_LINEAR_MIPMAP_LINEAR textures.
+  class VulkanBackend final {
+    static constexpr std::size_t bytes_per_texel = 4;
+    static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr std::size_t frames_in_flight = 2;
+    // Descriptor sets per pool. Another pool is added whenever all are full.
+    static constexpr std::uint32_t descriptor_pool_size = 256;
+  public:
+    using Texture = VulkanTexture;
+
+    VulkanBackend(std::size_t width, std::size_t height)
+      : target_width{static_cast<std::uint32_t>(width)}
+      , target_height{static_cast<std::uint32_t>(height)}
+    {
+      ready = create_instance()
+        && pick_physical_device()
+        && create_device()
+        && create_render_target()
+        && create_pipeline()
+        && create_commands();
+    }
+    VulkanBackend(VulkanBackend const&) = delete;
+    VulkanBackend(VulkanBackend&&) = delete;
+    VulkanBackend& operator=(VulkanBackend const&) = delete;
+    VulkanBackend& operator=(VulkanBackend&&) = delete;
+    ~VulkanBackend() {
+      if (device) {
+        vkDeviceWaitIdle(device);
+        collect_retired(frame_value);
+        if (staging) vkDestroyBuffer(device, staging, nullptr);
+        if (staging_memory) vkFreeMemory(device, staging_memory, nullptr);
+        if (upload_timeline) vkDestroySemaphore(device, upload_timeline, nullptr);
+        if (frame_timeline) vkDestroySemaphore(device, frame_timeline, nullptr);
+        if (transfer_pool) vkDestroyCommandPool(device, transfer_pool, nullptr);
+        if (graphics_pool) vkDestroyCommandPool(device, graphics_pool, nullptr);
+        if (pipeline) vkDestroyPipeline(device, pipeline, nullptr);
+        if (pipeline_layout) vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+        for (auto &pool : descriptor_pools) vkDestroyDescriptorPool(device, pool.pool, nullptr);
+        if (descriptor_set_layout) vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+        if (sampler) vkDestroySampler(device, sampler, nullptr);
+        if (framebuffer) vkDestroyFramebuffer(device, framebuffer, nullptr);
+        if (render_pass) vkDestroyRenderPass(device, render_pass, nullptr);
+        if (target_view) vkDestroyImageView(device, target_view, nullptr);
+        if (target) vkDestroyImage(device, target, nullptr);
+        if (target_memory.block) arena->release(target_memory);
+        arena.reset();
+        vkDestroyDevice(device, nullptr);
+      }
+      if (messenger) {
+        auto destroy = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
+          vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT")
+        );
+        destroy(instance, messenger, nullptr);
+      }
+      if (instance) vkDestroyInstance(instance, nullptr);
+    }
+
+    explicit operator bool() const { return ready; }
+
+    // Errors reported by validation layers, when any are enabled
+    std::size_t validation_errors() const { return validation_error_count; }
+
+    std::size_t max_texture_dimension() const { return max_dimension; }
+
+    template <typename Faker, typename OnSuccess, typename OnFailure>
+    auto create_texture(
+      std::size_t width, std::size_t height, Faker &faker,
+      OnSuccess on_success, OnFailure on_failure
+    ) {
+      // Same mip chain as the GL backend
+      std::uint32_t levels = std::uint32_t(std::log2(std::min(width, height))) + 1;
+
+      VulkanTexture::Resources resources{};
+      if (!create_texture_resources(width, height, levels, resources)) return on_failure();
+
+      std::size_t texture_size = 0;
+      for (std::uint32_t level = 0; level < levels; ++level) {
+        texture_size += (width >> level) * (height >> level) * bytes_per_texel;
+      }
+      if (!prepare_staging(texture_size)) {
+        destroy_texture_resources(resources);
+        return on_failure();
+      }
+
+      VkCommandBufferBeginInfo begin_info{};
+      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(upload_commands, &begin_info);
+      transition(
+        upload_commands, resources.image, levels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+      );
+
+      VkDeviceSize offset = 0;
+      for (std::uint32_t level = 0; level < levels; ++level) {
+        std::size_t level_width = width >> level;
+        std::size_t level_height = height >> level;
+        std::size_t size = level_width * level_height * bytes_per_texel;
+        faker.recolor(size, [&](auto data) {
+          std::memcpy(static_cast<char *>(staging_data) + offset, data, size);
+        });
+
+        VkBufferImageCopy copy{};
+        copy.bufferOffset = offset;
+        copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.imageSubresource.mipLevel = level;
+        copy.imageSubresource.layerCount = 1;
+        copy.imageExtent = {
+          static_cast<std::uint32_t>(level_width),
+          static_cast<std::uint32_t>(level_height),
+          1
+        };
+        vkCmdCopyBufferToImage(
+          upload_commands, staging, resources.image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy
+        );
+        offset += size;
+      }
+
+      // The transfer queue cannot name the fragment shader stage. Frames wait
+      // on the upload timeline at that stage instead, which orders their
+      // reads after this transition.
+      transition(
+        upload_commands, resources.image, levels,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0
+      );
+      vkEndCommandBuffer(upload_commands);
+
+      if (!submit(transfer_queue, upload_commands, VK_NULL_HANDLE, 0, 0, upload_timeline, upload_value + 1)) {
+        destroy_texture_resources(resources);
+        return on_failure();
+      }
+      ++upload_value;
+
+      return on_success(VulkanTexture{this, resources, texture_size, width, height});
+    }
+
+    // Waits for submitted frames so that retired textures release their memory
+    void recover() {
+      if (frame_value == 0) return;
+      wait(frame_timeline, frame_value - 1);
+      collect_retired(frame_value - 1);
+    }
+
+    void begin_frame() {
+      ++frame_value;
+      // Pace the CPU so that at most frames_in_flight frames are queued
+      if (frame_value > frames_in_flight) {
+        wait(frame_timeline, frame_value - frames_in_flight);
+      }
+      std::uint64_t completed = 0;
+      vkGetSemaphoreCounterValue(device, frame_timeline, &completed);
+      collect_retired(completed);
+
+      auto commands = frame_commands[frame_value % frames_in_flight];
+      vkResetCommandBuffer(commands, 0);
+      VkCommandBufferBeginInfo begin_info{};
+      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(commands, &begin_info);
+
+      VkClearValue red{};
+      red.color.float32[0] = 1.0f;
+      red.color.float32[3] = 1.0f;
+      VkRenderPassBeginInfo pass_info{};
+      pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      pass_info.renderPass = render_pass;
+      pass_info.framebuffer = framebuffer;
+      pass_info.renderArea.extent = {target_width, target_height};
+      pass_info.clearValueCount = 1;
+      pass_info.pClearValues = &red;
+      vkCmdBeginRenderPass(commands, &pass_info, VK_SUBPASS_CONTENTS_INLINE);
+      vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    }
+
+    void draw(VulkanTexture const &texture, QuadPlacement const &placement) {
+      auto commands = frame_commands[frame_value % frames_in_flight];
+      vkCmdBindDescriptorSets(
+        commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout,
+        0, 1, &texture.resources.descriptor_set, 0, nullptr
+      );
+      // The vertex shader's Rect push constant
+      float rect[] = {placement.left, placement.right, placement.bottom, placement.top};
+      vkCmdPushConstants(
+        commands, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(rect), rect
+      );
+      vkCmdDraw(commands, 4, 1, 0, 0);
+    }
+
+    void end_frame() {
+      auto commands = frame_commands[frame_value % frames_in_flight];
+      vkCmdEndRenderPass(commands);
+      vkEndCommandBuffer(commands);
+      submit(
+        graphics_queue, commands,
+        upload_timeline, upload_value,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        frame_timeline, frame_value
+      );
+    }
+
+  private:
+    friend class VulkanTexture;
+
+    struct Retired {
+      VulkanTexture::Resources resources;
+      std::uint64_t frame;
+    };
+
+    struct DescriptorPool {
+      VkDescriptorPool pool;
+      std::uint32_t free_sets;
+    };
+
+    bool create_instance() {
+      VkApplicationInfo application{};
+      application.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+      application.pApplicationName = "thrasher";
+      application.apiVersion = VK_API_VERSION_1_2;
+
+      // Lets validation layers, such as VK_LAYER_KHRONOS_validation enabled
+      // through VK_INSTANCE_LAYERS, report errors back to the backend
+      char const *extensions[] = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
+      bool debug_utils = has_instance_extension(extensions[0]);
+
+      VkInstanceCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+      info.pApplicationInfo = &application;
+      info.enabledExtensionCount = debug_utils ? 1 : 0;
+      info.ppEnabledExtensionNames = extensions;
+      if (!detail::vk_check(vkCreateInstance(&info, nullptr, &instance), "vkCreateInstance")) {
+        return false;
+      }
+      return !debug_utils || create_messenger();
+    }
+
+    static bool has_instance_extension(char const *name) {
+      std::uint32_t count = 0;
+      vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+      std::vector<VkExtensionProperties> extensions(count);
+      vkEnumerateInstanceExtensionProperties(nullptr, &count, extensions.data());
+      return std::any_of(begin(extensions), end(extensions), [&](auto &extension) {
+        return std::strcmp(extension.extensionName, name) == 0;
+      });
+    }
+
+    bool create_messenger() {
+      auto create = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
+        vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT")
+      );
+      VkDebugUtilsMessengerCreateInfoEXT info{};
+      info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+      info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+      info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+      info.pfnUserCallback = report_validation_error;
+      info.pUserData = &validation_error_count;
+      if (!detail::vk_check(create(instance, &info, nullptr, &messenger), "vkCreateDebugUtilsMessengerEXT")) {
+        messenger = VK_NULL_HANDLE;
+        return false;
+      }
+      return true;
+    }
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL report_validation_error(
+      VkDebugUtilsMessageSeverityFlagBitsEXT,
+      VkDebugUtilsMessageTypeFlagsEXT,
+      VkDebugUtilsMessengerCallbackDataEXT const *data,
+      void *error_count
+    ) {
+      fprintf(stderr, "%s\n", data->pMessage);
+      ++*static_cast<std::size_t *>(error_count);
+      return VK_FALSE;
+    }
+
+    // Prefers real GPUs, falling back to CPU implementations like lavapipe
+    bool pick_physical_device() {
+      std::uint32_t count = 0;
+      vkEnumeratePhysicalDevices(instance, &count, nullptr);
+      std::vector<VkPhysicalDevice> candidates(count);
+      vkEnumeratePhysicalDevices(instance, &count, candidates.data());
+
+      auto rank = [](VkPhysicalDeviceType type) {
+        switch (type) {
+          case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+          case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+          case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+          case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+          default: return 0;
+        }
+      };
+
+      int best_rank = -1;
+      for (auto candidate : candidates) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(candidate, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_2) continue;
+
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(candidate, &features);
+        if (!features12.timelineSemaphore) continue;
+
+        std::uint32_t graphics, transfer, transfer_index;
+        if (!find_queues(candidate, graphics, transfer, transfer_index)) continue;
+
+        if (rank(properties.deviceType) <= best_rank) continue;
+        best_rank = rank(properties.deviceType);
+        physical_device = candidate;
+        graphics_family = graphics;
+        transfer_family = transfer;
+        transfer_queue_index = transfer_index;
+        max_dimension = properties.limits.maxImageDimension2D;
+      }
+
+      if (!physical_device) {
+        fprintf(stderr, "No Vulkan 1.2 device with timeline semaphores\n");
+        return false;
+      }
+
+      VkPhysicalDeviceProperties properties;
+      vkGetPhysicalDeviceProperties(physical_device, &properties);
+      printf("vulkan device: %s\n", properties.deviceName);
+
+      if (target_width > max_dimension || target_height > max_dimension) {
+        fprintf(stderr, "Render target is larger than the device supports\n");
+        return false;
+      }
+
+      VkFormatProperties format_properties;
+      vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+      VkFormatFeatureFlags required =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+      if ((format_properties.optimalTilingFeatures & required) != required) {
+        fprintf(stderr, "RGBA8 images cannot be filtered and rendered to on this device\n");
+        return false;
+      }
+      return true;
+    }
+
+    // Uses a transfer-only family when there is one, then a second queue in
+    // the graphics family, then the graphics queue itself
+    static bool find_queues(
+      VkPhysicalDevice candidate,
+      std::uint32_t &graphics,
+      std::uint32_t &transfer,
+      std::uint32_t &transfer_index
+    ) {
+      std::uint32_t count = 0;
+      vkGetPhysicalDeviceQueueFamilyProperties(candidate, &count, nullptr);
+      std::vector<VkQueueFamilyProperties> families(count);
+      vkGetPhysicalDeviceQueueFamilyProperties(candidate, &count, families.data());
+
+      bool found = false;
+      for (std::uint32_t i = 0; i < count; ++i) {
+        if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+          graphics = i;
+          found = true;
+          break;
+        }
+      }
+      if (!found) return false;
+
+      for (std::uint32_t i = 0; i < count; ++i) {
+        auto flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+          transfer = i;
+          transfer_index = 0;
+          return true;
+        }
+      }
+
+      transfer = graphics;
+      transfer_index = families[graphics].queueCount > 1 ? 1 : 0;
+      return true;
+    }
+
+    bool create_device() {
+      float priorities[] = {1.0f, 1.0f};
+      std::array<VkDeviceQueueCreateInfo, 2> queues{};
+      queues[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      queues[0].queueFamilyIndex = graphics_family;
+      queues[0].queueCount = 1;
+      queues[0].pQueuePriorities = priorities;
+      std::uint32_t queue_count = 1;
+      if (transfer_family != graphics_family) {
+        queues[1] = queues[0];
+        queues[1].queueFamilyIndex = transfer_family;
+        queue_count = 2;
+      } else {
+        queues[0].queueCount = transfer_queue_index + 1;
+      }
+
+      VkPhysicalDeviceVulkan12Features features12{};
+      features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+      features12.timelineSemaphore = VK_TRUE;
+
+      VkDeviceCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+      info.pNext = &features12;
+      info.queueCreateInfoCount = queue_count;
+      info.pQueueCreateInfos = queues.data();
+      if (!detail::vk_check(vkCreateDevice(physical_device, &info, nullptr, &device), "vkCreateDevice")) {
+        return false;
+      }
+
+      vkGetDeviceQueue(device, graphics_family, 0, &graphics_queue);
+      vkGetDeviceQueue(device, transfer_family, transfer_queue_index, &transfer_queue);
+      arena.reset(new DeviceMemoryArena{physical_device, device});
+      return true;
+    }
+
+    bool create_render_target() {
+      if (!create_image(target_width, target_height, 1, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, target, target_memory)) {
+        return false;
+      }
+      if (!create_view(target, 1, target_view)) return false;
+
+      VkAttachmentDescription attachment{};
+      attachment.format = format;
+      attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+      VkAttachmentReference color{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+      VkSubpassDescription subpass{};
+      subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpass.colorAttachmentCount = 1;
+      subpass.pColorAttachments = &color;
+
+      // Orders each frame's clear after the previous frame's draws
+      VkSubpassDependency dependency{};
+      dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+      dependency.dstSubpass = 0;
+      dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+      VkRenderPassCreateInfo pass_info{};
+      pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+      pass_info.attachmentCount = 1;
+      pass_info.pAttachments = &attachment;
+      pass_info.subpassCount = 1;
+      pass_info.pSubpasses = &subpass;
+      pass_info.dependencyCount = 1;
+      pass_info.pDependencies = &dependency;
+      if (!detail::vk_check(vkCreateRenderPass(device, &pass_info, nullptr, &render_pass), "vkCreateRenderPass")) {
+        return false;
+      }
+
+      VkFramebufferCreateInfo framebuffer_info{};
+      framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+      framebuffer_info.renderPass = render_pass;
+      framebuffer_info.attachmentCount = 1;
+      framebuffer_info.pAttachments = &target_view;
+      framebuffer_info.width = target_width;
+      framebuffer_info.height = target_height;
+      framebuffer_info.layers = 1;
+      return detail::vk_check(vkCreateFramebuffer(device, &framebuffer_info, nullptr, &framebuffer), "vkCreateFramebuffer");
+    }
+
+    bool create_pipeline() {
+      VkSamplerCreateInfo sampler_info{};
+      sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+      sampler_info.magFilter = VK_FILTER_LINEAR;
+      sampler_info.minFilter = VK_FILTER_LINEAR;
+      sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+      sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+      sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+      sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+      sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+      if (!detail::vk_check(vkCreateSampler(device, &sampler_info, nullptr, &sampler), "vkCreateSampler")) {
+        return false;
+      }
+
+      VkDescriptorSetLayoutBinding binding{};
+      binding.binding = 0;
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      binding.descriptorCount = 1;
+      binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+      VkDescriptorSetLayoutCreateInfo set_layout_info{};
+      set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      set_layout_info.bindingCount = 1;
+      set_layout_info.pBindings = &binding;
+      if (!detail::vk_check(vkCreateDescriptorSetLayout(device, &set_layout_info, nullptr, &descriptor_set_layout), "vkCreateDescriptorSetLayout")) {
+        return false;
+      }
+
+      VkPushConstantRange rect{VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float)};
+      VkPipelineLayoutCreateInfo layout_info{};
+      layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+      layout_info.setLayoutCount = 1;
+      layout_info.pSetLayouts = &descriptor_set_layout;
+      layout_info.pushConstantRangeCount = 1;
+      layout_info.pPushConstantRanges = &rect;
+      if (!detail::vk_check(vkCreatePipelineLayout(device, &layout_info, nullptr, &pipeline_layout), "vkCreatePipelineLayout")) {
+        return false;
+      }
+
+      VkShaderModule vertex_shader, fragment_shader;
+      if (!create_shader(detail::quad_vertex_shader, vertex_shader)) return false;
+      if (!create_shader(detail::quad_fragment_shader, fragment_shader)) {
+        vkDestroyShaderModule(device, vertex_shader, nullptr);
+        return false;
+      }
+
+      std::array<VkPipelineShaderStageCreateInfo, 2> stages{};
+      stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+      stages[0].module = vertex_shader;
+      stages[0].pName = "main";
+      stages[1] = stages[0];
+      stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+      stages[1].module = fragment_shader;
+
+      // Vertices come from gl_VertexIndex, so there is no vertex input
+      VkPipelineVertexInputStateCreateInfo vertex_input{};
+      vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+      VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+      input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+      input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+      VkViewport viewport{0.0f, 0.0f, float(target_width), float(target_height), 0.0f, 1.0f};
+      VkRect2D scissor{{0, 0}, {target_width, target_height}};
+      VkPipelineViewportStateCreateInfo viewport_state{};
+      viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+      viewport_state.viewportCount = 1;
+      viewport_state.pViewports = &viewport;
+      viewport_state.scissorCount = 1;
+      viewport_state.pScissors = &scissor;
+
+      // Mirrored quads wind the other way, and must still be drawn
+      VkPipelineRasterizationStateCreateInfo rasterization{};
+      rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+      rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+      rasterization.cullMode = VK_CULL_MODE_NONE;
+      rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+      rasterization.lineWidth = 1.0f;
+
+      VkPipelineMultisampleStateCreateInfo multisample{};
+      multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+      multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+      VkPipelineColorBlendAttachmentState blend_attachment{};
+      blend_attachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+      VkPipelineColorBlendStateCreateInfo blend{};
+      blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+      blend.attachmentCount = 1;
+      blend.pAttachments = &blend_attachment;
+
+      VkGraphicsPipelineCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+      info.stageCount = static_cast<std::uint32_t>(stages.size());
+      info.pStages = stages.data();
+      info.pVertexInputState = &vertex_input;
+      info.pInputAssemblyState = &input_assembly;
+      info.pViewportState = &viewport_state;
+      info.pRasterizationState = &rasterization;
+      info.pMultisampleState = &multisample;
+      info.pColorBlendState = &blend;
+      info.layout = pipeline_layout;
+      info.renderPass = render_pass;
+      info.subpass = 0;
+      bool created = detail::vk_check(
+        vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline),
+        "vkCreateGraphicsPipelines"
+      );
+
+      vkDestroyShaderModule(device, fragment_shader, nullptr);
+      vkDestroyShaderModule(device, vertex_shader, nullptr);
+      return created;
+    }
+
+    template <std::size_t words>
+    bool create_shader(std::uint32_t const (&code)[words], VkShaderModule &module) {
+      VkShaderModuleCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+      info.codeSize = sizeof(code);
+      info.pCode = code;
+      return detail::vk_check(vkCreateShaderModule(device, &info, nullptr, &module), "vkCreateShaderModule");
+    }
+
+    bool create_commands() {
+      VkCommandPoolCreateInfo pool_info{};
+      pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+      pool_info.queueFamilyIndex = graphics_family;
+      if (!detail::vk_check(vkCreateCommandPool(device, &pool_info, nullptr, &graphics_pool), "vkCreateCommandPool")) {
+        return false;
+      }
+      pool_info.queueFamilyIndex = transfer_family;
+      if (!detail::vk_check(vkCreateCommandPool(device, &pool_info, nullptr, &transfer_pool), "vkCreateCommandPool")) {
+        return false;
+      }
+
+      VkCommandBufferAllocateInfo allocate_info{};
+      allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocate_info.commandPool = graphics_pool;
+      allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocate_info.commandBufferCount = frames_in_flight;
+      if (!detail::vk_check(vkAllocateCommandBuffers(device, &allocate_info, frame_commands.data()), "vkAllocateCommandBuffers")) {
+        return false;
+      }
+      allocate_info.commandPool = transfer_pool;
+      allocate_info.commandBufferCount = 1;
+      if (!detail::vk_check(vkAllocateCommandBuffers(device, &allocate_info, &upload_commands), "vkAllocateCommandBuffers")) {
+        return false;
+      }
+
+      return create_timeline(frame_timeline) && create_timeline(upload_timeline);
+    }
+
+    bool create_timeline(VkSemaphore &semaphore) {
+      VkSemaphoreTypeCreateInfo type_info{};
+      type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+      type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+      type_info.initialValue = 0;
+      VkSemaphoreCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      info.pNext = &type_info;
+      return detail::vk_check(vkCreateSemaphore(device, &info, nullptr, &semaphore), "vkCreateSemaphore");
+    }
+
+    // Leaves image null and allocation empty on failure
+    bool create_image(
+      std::size_t width, std::size_t height, std::uint32_t levels, VkImageUsageFlags usage,
+      VkImage &image, DeviceMemoryArena::Allocation &allocation
+    ) {
+      std::uint32_t families[] = {graphics_family, transfer_family};
+      VkImageCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      info.imageType = VK_IMAGE_TYPE_2D;
+      info.format = format;
+      info.extent = {static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), 1};
+      info.mipLevels = levels;
+      info.arrayLayers = 1;
+      info.samples = VK_SAMPLE_COUNT_1_BIT;
+      info.tiling = VK_IMAGE_TILING_OPTIMAL;
+      info.usage = usage;
+      // Uploaded images are shared concurrently, which saves queue family
+      // ownership transfers
+      if ((usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && graphics_family != transfer_family) {
+        info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info.queueFamilyIndexCount = 2;
+        info.pQueueFamilyIndices = families;
+      } else {
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      }
+      info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      if (!detail::vk_check(vkCreateImage(device, &info, nullptr, &image), "vkCreateImage")) {
+        image = VK_NULL_HANDLE;
+        return false;
+      }
+
+      VkMemoryRequirements requirements;
+      vkGetImageMemoryRequirements(device, image, &requirements);
+      if (!arena->allocate(requirements, allocation)) {
+        vkDestroyImage(device, image, nullptr);
+        image = VK_NULL_HANDLE;
+        return false;
+      }
+      if (!detail::vk_check(vkBindImageMemory(device, image, allocation.memory, allocation.offset), "vkBindImageMemory")) {
+        destroy_image(image, allocation);
+        image = VK_NULL_HANDLE;
+        allocation = {};
+        return false;
+      }
+      return true;
+    }
+
+    void destroy_image(VkImage image, DeviceMemoryArena::Allocation const &allocation) {
+      vkDestroyImage(device, image, nullptr);
+      arena->release(allocation);
+    }
+
+    bool create_view(VkImage image, std::uint32_t levels, VkImageView &view) {
+      VkImageViewCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      info.image = image;
+      info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      info.format = format;
+      info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+      if (!detail::vk_check(vkCreateImageView(device, &info, nullptr, &view), "vkCreateImageView")) {
+        view = VK_NULL_HANDLE;
+        return false;
+      }
+      return true;
+    }
+
+    bool create_texture_resources(
+      std::size_t width, std::size_t height, std::uint32_t levels,
+      VulkanTexture::Resources &resources
+    ) {
+      VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+      if (!create_image(width, height, levels, usage, resources.image, resources.allocation)) {
+        return false;
+      }
+      if (!create_view(resources.image, levels, resources.view) ||
+          !allocate_descriptor_set(resources.descriptor_pool, resources.descriptor_set)) {
+        destroy_texture_resources(resources);
+        return false;
+      }
+
+      VkDescriptorImageInfo image_info{
+        sampler, resources.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+      };
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = resources.descriptor_set;
+      write.dstBinding = 0;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      write.pImageInfo = &image_info;
+      vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+      return true;
+    }
+
+    void destroy_texture_resources(VulkanTexture::Resources const &resources) {
+      if (resources.descriptor_set) {
+        auto &pool = descriptor_pools[resources.descriptor_pool];
+        vkFreeDescriptorSets(device, pool.pool, 1, &resources.descriptor_set);
+        ++pool.free_sets;
+      }
+      if (resources.view) vkDestroyImageView(device, resources.view, nullptr);
+      destroy_image(resources.image, resources.allocation);
+    }
+
+    // Pools are counted rather than allocated from until they fail, and are
+    // kept until the backend is destroyed
+    bool allocate_descriptor_set(std::size_t &pool_index, VkDescriptorSet &set) {
+      auto pool = std::find_if(
+        begin(descriptor_pools), end(descriptor_pools),
+        [](auto &candidate) { return candidate.free_sets != 0; }
+      );
+      if (pool == end(descriptor_pools)) {
+        VkDescriptorPoolSize size{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptor_pool_size};
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        pool_info.maxSets = descriptor_pool_size;
+        pool_info.poolSizeCount = 1;
+        pool_info.pPoolSizes = &size;
+        VkDescriptorPool created;
+        if (!detail::vk_check(vkCreateDescriptorPool(device, &pool_info, nullptr, &created), "vkCreateDescriptorPool")) {
+          set = VK_NULL_HANDLE;
+          return false;
+        }
+        descriptor_pools.push_back({created, descriptor_pool_size});
+        pool = std::prev(end(descriptor_pools));
+      }
+
+      VkDescriptorSetAllocateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      info.descriptorPool = pool->pool;
+      info.descriptorSetCount = 1;
+      info.pSetLayouts = &descriptor_set_layout;
+      if (!detail::vk_check(vkAllocateDescriptorSets(device, &info, &set), "vkAllocateDescriptorSets")) {
+        set = VK_NULL_HANDLE;
+        return false;
+      }
+      --pool->free_sets;
+      pool_index = pool - begin(descriptor_pools);
+      return true;
+    }
+
+    // Waits for the previous upload, since there is one staging buffer, and
+    // grows the staging buffer if needed
+    bool prepare_staging(std::size_t bytes) {
+      wait(upload_timeline, upload_value);
+      vkResetCommandBuffer(upload_commands, 0);
+      if (bytes <= staging_size) return true;
+
+      if (staging) vkDestroyBuffer(device, staging, nullptr);
+      if (staging_memory) vkFreeMemory(device, staging_memory, nullptr);
+      staging = VK_NULL_HANDLE;
+      staging_memory = VK_NULL_HANDLE;
+      staging_size = 0;
+
+      VkBufferCreateInfo buffer_info{};
+      buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      buffer_info.size = bytes;
+      buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+      buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      if (!detail::vk_check(vkCreateBuffer(device, &buffer_info, nullptr, &staging), "vkCreateBuffer")) {
+        staging = VK_NULL_HANDLE;
+        return false;
+      }
+
+      VkMemoryRequirements requirements;
+      vkGetBufferMemoryRequirements(device, staging, &requirements);
+      VkPhysicalDeviceMemoryProperties memory_properties;
+      vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+      VkMemoryPropertyFlags wanted =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      VkMemoryAllocateInfo allocate_info{};
+      allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocate_info.allocationSize = requirements.size;
+      allocate_info.memoryTypeIndex = memory_properties.memoryTypeCount;
+      for (std::uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        if ((requirements.memoryTypeBits & (1u << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+          allocate_info.memoryTypeIndex = i;
+          break;
+        }
+      }
+      if (allocate_info.memoryTypeIndex == memory_properties.memoryTypeCount) {
+        fprintf(stderr, "No host visible memory for staging\n");
+        return false;
+      }
+      if (!detail::vk_check(vkAllocateMemory(device, &allocate_info, nullptr, &staging_memory), "vkAllocateMemory")) {
+        staging_memory = VK_NULL_HANDLE;
+        return false;
+      }
+      if (!detail::vk_check(vkBindBufferMemory(device, staging, staging_memory, 0), "vkBindBufferMemory")) {
+        return false;
+      }
+      if (!detail::vk_check(vkMapMemory(device, staging_memory, 0, VK_WHOLE_SIZE, 0, &staging_data), "vkMapMemory")) {
+        return false;
+      }
+
+      staging_size = bytes;
+      return true;
+    }
+
+    static void transition(
+      VkCommandBuffer commands, VkImage image, std::uint32_t levels,
+      VkImageLayout from, VkImageLayout to,
+      VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+      VkPipelineStageFlags dst_stage, VkAccessFlags dst_access
+    ) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = src_access;
+      barrier.dstAccessMask = dst_access;
+      barrier.oldLayout = from;
+      barrier.newLayout = to;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+      vkCmdPipelineBarrier(
+        commands, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier
+      );
+    }
+
+    bool submit(
+      VkQueue queue, VkCommandBuffer commands,
+      VkSemaphore wait_semaphore, std::uint64_t wait_value, VkPipelineStageFlags wait_stage,
+      VkSemaphore signal_semaphore, std::uint64_t signal_value
+    ) {
+      VkTimelineSemaphoreSubmitInfo timeline_info{};
+      timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+      timeline_info.waitSemaphoreValueCount = wait_semaphore ? 1 : 0;
+      timeline_info.pWaitSemaphoreValues = &wait_value;
+      timeline_info.signalSemaphoreValueCount = 1;
+      timeline_info.pSignalSemaphoreValues = &signal_value;
+
+      VkSubmitInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      info.pNext = &timeline_info;
+      info.waitSemaphoreCount = wait_semaphore ? 1 : 0;
+      info.pWaitSemaphores = &wait_semaphore;
+      info.pWaitDstStageMask = &wait_stage;
+      info.commandBufferCount = 1;
+      info.pCommandBuffers = &commands;
+      info.signalSemaphoreCount = 1;
+      info.pSignalSemaphores = &signal_semaphore;
+      return detail::vk_check(vkQueueSubmit(queue, 1, &info, VK_NULL_HANDLE), "vkQueueSubmit");
+    }
+
+    void wait(VkSemaphore semaphore, std::uint64_t value) {
+      VkSemaphoreWaitInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      info.semaphoreCount = 1;
+      info.pSemaphores = &semaphore;
+      info.pValues = &value;
+      detail::vk_check(vkWaitSemaphores(device, &info, UINT64_MAX), "vkWaitSemaphores");
+    }
+
+    // Deleted textures may still be read by frames in flight, so they are
+    // destroyed once the frame that was recording when they died completes
+    void retire(VulkanTexture::Resources const &resources) {
+      retired.push_back({resources, frame_value});
+    }
+
+    void collect_retired(std::uint64_t completed_frame) {
+      auto still_in_use = std::partition(
+        begin(retired), end(retired),
+        [&](auto &texture) { return texture.frame > completed_frame; }
+      );
+      for (auto texture = still_in_use; texture != end(retired); ++texture) {
+        destroy_texture_resources(texture->resources);
+      }
+      retired.erase(still_in_use, end(retired));
+    }
+
+    bool ready = false;
+    VkInstance instance = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerEXT messenger = VK_NULL_HANDLE;
+    std::size_t validation_error_count = 0;
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    std::uint32_t graphics_family = 0;
+    std::uint32_t transfer_family = 0;
+    std::uint32_t transfer_queue_index = 0;
+    VkQueue graphics_queue = VK_NULL_HANDLE;
+    VkQueue transfer_queue = VK_NULL_HANDLE;
+    std::size_t max_dimension = 0;
+    std::unique_ptr<DeviceMemoryArena> arena;
+
+    std::uint32_t target_width;
+    std::uint32_t target_height;
+    VkImage target = VK_NULL_HANDLE;
+    DeviceMemoryArena::Allocation target_memory{};
+    VkImageView target_view = VK_NULL_HANDLE;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    std::vector<DescriptorPool> descriptor_pools;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    VkCommandPool graphics_pool = VK_NULL_HANDLE;
+    std::array<VkCommandBuffer, frames_in_flight> frame_commands{};
+    VkSemaphore frame_timeline = VK_NULL_HANDLE;
+    // The value the frame being recorded will signal
+    std::uint64_t frame_value = 0;
+
+    VkCommandPool transfer_pool = VK_NULL_HANDLE;
+    VkCommandBuffer upload_commands = VK_NULL_HANDLE;
+    VkSemaphore upload_timeline = VK_NULL_HANDLE;
+    // The value the last submitted upload will signal
+    std::uint64_t upload_value = 0;
+    VkBuffer staging = VK_NULL_HANDLE;
+    VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+    void *staging_data = nullptr;
+    std::size_t staging_size = 0;
+
+    std::vector<Retired> retired;
+  };
+
+  inline void VulkanTexture::reset() {
+    if (!resources.image) return;
+    owner->retire(resources);
+    resources.image = VK_NULL_HANDLE;
+  }
+
+  template <typename Callback>
+  inline bool openVulkan(std::size_t width, std::size_t height, Callback callback) {
+    VulkanBackend backend{width, height};
+    if (!static_cast<bool>(backend)) return false;
+
+    bool result = callback(backend);
+    if (backend.validation_errors() != 0) {
+      fprintf(stderr, "%lu Vulkan validation errors\n", backend.validation_errors());
+      return false;
+    }
+    return result;
+  }
+}
+
+#endif